@@ -43,6 +43,49 @@ interface FreetypeModule {
   SetCharmap: (encoding: number) => FT_CharMapRec;
   SetCharmapByIndex: (index: number) => FT_CharMapRec;
 
+  /**
+   * Evict least recently used fonts when the loaded fonts use more than
+   * `budget` bytes. The current font is never evicted. 0 is unlimited.
+   */
+  SetFacePoolBudget: (budget: number) => void;
+
+  /**
+   * Provide bytes of the font containing the face when `SetFont` is called
+   * with an evicted face.
+   */
+  SetFontProvider: (
+    provider: (familyName: string, styleName: string) => Uint8Array | null
+  ) => void;
+
+  /** Bytes used by the loaded fonts */
+  GetFacePoolUsage: () => number;
+
+  GetFacePoolFaces: () => FacePoolFace[];
+
+  /**
+   * Store glyphs and kernings loaded after this call to the glyph cache, so
+   * they can be exported with `ExportGlyphCache`. Imported glyphs are used
+   * even when disabled.
+   */
+  EnableGlyphCache: (enable: boolean) => void;
+
+  ClearGlyphCache: () => void;
+
+  /**
+   * Serialize the glyph cache to a versioned binary snapshot, e.g. to store
+   * it in IndexedDB.
+   */
+  ExportGlyphCache: () => Uint8Array;
+
+  /**
+   * Populate the glyph cache from a snapshot. Glyphs are returned from the
+   * cache when the same font file is set with the same size and load flags.
+   *
+   * @returns false if the snapshot is invalid
+   */
+  ImportGlyphCache: (snapshot: Uint8Array | number[]) => boolean;
+
+  /** Unload all fonts, reset the face pool budget and the font provider */
   Cleanup: () => void;
 
   FT_GLYPH_FORMAT_NONE: number;
@@ -126,6 +169,17 @@ interface FreetypeModule {
   FT_PIXEL_MODE_MAX: number;
 }
 
+export interface FacePoolFace {
+  family_name: string;
+  style_name: string;
+  loaded: boolean;
+  /** Memory allocated by FreeType for the face, its size and glyph slot */
+  face_bytes: number;
+  /** Size of the font file, shared by the faces of a font collection */
+  font_bytes: number;
+  last_used: number;
+}
+
 export interface FT_Glyph_Metrics {
   width: number;
   height: number;
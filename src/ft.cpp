@@ -1,7 +1,15 @@
+#include <limits.h>
+#include <stddef.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <string.h>
 
+#include <map>
+#include <tuple>
+#include <vector>
+
 #include <freetype/freetype.h>
+#include <freetype/ftmodapi.h>
 
 #include <emscripten/emscripten.h>
 #include <emscripten/val.h>
@@ -9,6 +17,62 @@
 
 FT_Face current_face;
 
+// Bytes allocated by FreeType, used to measure the memory of the faces
+size_t freetype_allocated = 0;
+
+// Memory used by the loaded font bytes and faces
+size_t face_pool_used = 0;
+
+// Allocations are prefixed with the size, FT_Free_Func is not given it
+union AllocationHeader
+{
+    size_t size;
+    max_align_t align;
+};
+
+void *CountingAlloc(FT_Memory memory, long size)
+{
+    auto header = (AllocationHeader *)::malloc(sizeof(AllocationHeader) + size);
+    if (header == nullptr)
+    {
+        return nullptr;
+    }
+    header->size = size;
+    freetype_allocated += size;
+    return header + 1;
+}
+
+void CountingFree(FT_Memory memory, void *block)
+{
+    if (block == nullptr)
+    {
+        return;
+    }
+    auto header = (AllocationHeader *)block - 1;
+    freetype_allocated -= header->size;
+    ::free(header);
+}
+
+void *CountingRealloc(FT_Memory memory, long cur_size, long new_size, void *block)
+{
+    if (block == nullptr)
+    {
+        return CountingAlloc(memory, new_size);
+    }
+    auto header = (AllocationHeader *)block - 1;
+    const size_t old_size = header->size;
+    header = (AllocationHeader *)::realloc(header, sizeof(AllocationHeader) + new_size);
+    if (header == nullptr)
+    {
+        return nullptr;
+    }
+    header->size = new_size;
+    freetype_allocated += new_size - old_size;
+    return header + 1;
+}
+
+FT_MemoryRec_ counting_memory = {nullptr, CountingAlloc, CountingFree, CountingRealloc};
+
 class FontPtr
 {
 public:
@@ -18,40 +82,219 @@ public:
         size = font.size();
         bytes = (FT_Bytes)::malloc(size);
         ::memcpy((void *)bytes, font.data(), size);
+
+        face_pool_used += size;
     }
 
     ~FontPtr()
     {
         // printf("free bytes?\n");
         ::free((void *)bytes);
+        face_pool_used -= size;
+    }
+
+    // FNV-1a hash of the bytes, identifies the font in glyph snapshots.
+    // Computed when the glyph cache first needs it.
+    FT_UInt32 Checksum()
+    {
+        if (!checksum_computed)
+        {
+            checksum = 2166136261u;
+            for (signed long i = 0; i < size; i++)
+            {
+                checksum = (checksum ^ bytes[i]) * 16777619u;
+            }
+            checksum_computed = true;
+        }
+        return checksum;
     }
 
     signed long size;
     FT_Bytes bytes;
+
+    // Face pool tick of the last use, least recently used fonts are evicted
+    // first
+    unsigned long last_used = 0;
+
+private:
+    FT_UInt32 checksum = 0;
+    bool checksum_computed = false;
 };
 
 class Font
 {
 public:
-    Font(FT_Face ft_face, std::shared_ptr<FontPtr> ptr)
+    Font(FT_Face ft_face, std::shared_ptr<FontPtr> ptr, long ft_face_memory)
     {
         face = ft_face;
         bytes = ptr;
+        face_memory = 0;
+        AddMemory(ft_face_memory);
     }
 
     ~Font()
     {
         // printf("free font?\n");
-        FT_Done_Face(face);
+        Evict();
+    }
+
+    // Release the face and the bytes, entry is kept so that it can be
+    // reloaded with the font provider
+    void Evict()
+    {
+        if (face != nullptr)
+        {
+            charmap_index = face->charmap != nullptr ? FT_Get_Charmap_Index(face->charmap) : -1;
+            FT_Done_Face(face);
+            face = nullptr;
+        }
+        AddMemory(-face_memory);
+        bytes.reset();
+    }
+
+    // Set the size and charmap of the evicted entry to the reloaded face
+    void Restore(const Font &evicted);
+
+    void AddMemory(long delta)
+    {
+        face_memory += delta;
+        face_pool_used += delta;
     }
+
     FT_Face face;
     std::shared_ptr<FontPtr> bytes;
+
+    // Memory allocated by FreeType for the face, its size and glyph slot
+    long face_memory;
+
+    // Last size set with SetCharSize or SetPixelSize, and the charmap of an
+    // evicted face, applied again when the face is reloaded
+    enum class SizeRequest
+    {
+        None,
+        Char,
+        Pixel
+    };
+    SizeRequest size_request = SizeRequest::None;
+    FT_F26Dot6 size_width = 0;
+    FT_F26Dot6 size_height = 0;
+    FT_UInt horz_resolution = 0;
+    FT_UInt vert_resolution = 0;
+    int charmap_index = -1;
 };
 
+// Adds the memory FreeType allocates during the scope to the font
+class FaceMemoryScope
+{
+public:
+    FaceMemoryScope(Font *font) : font(font), allocated(freetype_allocated) {}
+
+    ~FaceMemoryScope()
+    {
+        if (font != nullptr)
+        {
+            font->AddMemory((long)(freetype_allocated - allocated));
+        }
+    }
+
+private:
+    Font *font;
+    size_t allocated;
+};
+
+void Font::Restore(const Font &evicted)
+{
+    FaceMemoryScope scope(this);
+
+    size_request = evicted.size_request;
+    size_width = evicted.size_width;
+    size_height = evicted.size_height;
+    horz_resolution = evicted.horz_resolution;
+    vert_resolution = evicted.vert_resolution;
+
+    FT_Error error = 0;
+    if (size_request == SizeRequest::Char)
+    {
+        error = FT_Set_Char_Size(face, size_width, size_height, horz_resolution, vert_resolution);
+    }
+    else if (size_request == SizeRequest::Pixel)
+    {
+        error = FT_Set_Pixel_Sizes(face, size_width, size_height);
+    }
+    if (error)
+    {
+        fprintf(stderr, "FreeType: Error setting size of the reloaded face.\n");
+    }
+
+    if (evicted.charmap_index >= 0 && evicted.charmap_index < face->num_charmaps)
+    {
+        FT_Set_Charmap(face, face->charmaps[evicted.charmap_index]);
+    }
+}
+
 // FamilyName -> StyleName -> (FT_Bytes, FT_Face)
 std::map<std::string, std::map<std::string, std::unique_ptr<Font>>>
     face_map;
 
+// Font of the current_face, never evicted
+Font *current_font = nullptr;
+
+// Face pool, fonts are evicted in least recently used order when the memory
+// used by the loaded fonts exceeds the budget. Budget 0 is unlimited.
+size_t face_pool_budget = 0;
+unsigned long face_pool_tick = 0;
+
+// JS function (familyName, styleName) => Uint8Array | null, used to reload
+// evicted fonts
+emscripten::val font_provider = emscripten::val::null();
+
+// Glyph cache, can be exported as a snapshot and imported on later startups
+// so that the already rendered glyphs don't need to be rasterized again.
+
+// Identifies a face at a given size, checksum makes sure the entries are
+// never used with a different font file having the same family name
+struct GlyphCacheKey
+{
+    FT_UInt32 checksum;
+    std::string family_name;
+    std::string style_name;
+    FT_UShort x_ppem;
+    FT_UShort y_ppem;
+    FT_Fixed x_scale;
+    FT_Fixed y_scale;
+
+    bool operator<(const GlyphCacheKey &o) const
+    {
+        return std::tie(checksum, family_name, style_name, x_ppem, y_ppem, x_scale, y_scale) <
+               std::tie(o.checksum, o.family_name, o.style_name, o.x_ppem, o.y_ppem, o.x_scale, o.y_scale);
+    }
+};
+
+// Glyph slot with a copy of the bitmap buffer
+struct CachedGlyph
+{
+    FT_GlyphSlotRec slot;
+    std::vector<unsigned char> buffer;
+};
+
+struct GlyphCacheSet
+{
+    FT_Size_Metrics metrics;
+
+    // (load_flags, glyph_index) -> glyph, keyed by the glyph index as the
+    // glyph of a charcode depends on the selected charmap
+    std::map<std::pair<FT_Int32, FT_UInt>, CachedGlyph> glyphs;
+
+    // (left_glyph_index, right_glyph_index, kern_mode) -> kerning
+    std::map<std::tuple<FT_UInt, FT_UInt, FT_UInt>, FT_Vector> kerning;
+};
+
+std::map<GlyphCacheKey, GlyphCacheSet> glyph_cache;
+
+// Rendered glyphs are stored to the cache only when enabled, imported
+// snapshots are used regardless
+bool glyph_cache_enabled = false;
+
 FT_Library GetOrDeleteLibrary(bool deleteLibrary = false)
 {
     static bool inited = false;
@@ -60,7 +303,7 @@ FT_Library GetOrDeleteLibrary(bool deleteLibrary = false)
     {
         if (inited)
         {
-            FT_Done_FreeType(library);
+            FT_Done_Library(library);
             inited = false;
             library = nullptr;
         }
@@ -69,7 +312,10 @@ FT_Library GetOrDeleteLibrary(bool deleteLibrary = false)
     {
         if (!inited)
         {
-            FT_Init_FreeType(&library);
+            // Same as FT_Init_FreeType, but with allocations counted
+            FT_New_Library(&counting_memory, &library);
+            FT_Add_Default_Modules(library);
+            FT_Set_Default_Properties(library);
             inited = true;
         }
     }
@@ -78,10 +324,57 @@ FT_Library GetOrDeleteLibrary(bool deleteLibrary = false)
 
 void Cleanup()
 {
+    current_face = NULL;
+    current_font = nullptr;
     face_map.clear();
+    glyph_cache.clear();
+    font_provider = emscripten::val::null();
+    face_pool_budget = 0;
     GetOrDeleteLibrary(true);
 }
 
+// Evict least recently used fonts until the pool fits in the budget, the
+// current font and `keep` are not evicted
+void EnforceFacePoolBudget(const FontPtr *keep)
+{
+    const FontPtr *current = current_font != nullptr ? current_font->bytes.get() : nullptr;
+    while (face_pool_budget != 0 && face_pool_used > face_pool_budget)
+    {
+        const FontPtr *lru = nullptr;
+        for (auto &[family_name, styles] : face_map)
+        {
+            for (auto &[style_name, font] : styles)
+            {
+                if (font == nullptr || font->face == nullptr)
+                {
+                    continue;
+                }
+                const FontPtr *bytes = font->bytes.get();
+                if (bytes != current && bytes != keep && (lru == nullptr || bytes->last_used < lru->last_used))
+                {
+                    lru = bytes;
+                }
+            }
+        }
+        if (lru == nullptr)
+        {
+            return;
+        }
+
+        // Evicting the last face frees the bytes, so lru must not be read after
+        for (auto &[family_name, styles] : face_map)
+        {
+            for (auto &[style_name, font] : styles)
+            {
+                if (font != nullptr && font->bytes.get() == lru)
+                {
+                    font->Evict();
+                }
+            }
+        }
+    }
+}
+
 std::vector<FT_FaceRec> LoadFontFromBytes(std::vector<unsigned char> font)
 {
     FT_Library library = GetOrDeleteLibrary();
@@ -91,6 +384,7 @@ std::vector<FT_FaceRec> LoadFontFromBytes(std::vector<unsigned char> font)
 
     // Store the font to a wasm memory
     auto fns = std::make_shared<FontPtr>(font);
+    fns->last_used = ++face_pool_tick;
 
     // Get num of faces
     error = FT_New_Memory_Face(library, fns->bytes, fns->size, -1, &face_temp);
@@ -107,6 +401,7 @@ std::vector<FT_FaceRec> LoadFontFromBytes(std::vector<unsigned char> font)
     {
 
         FT_Face ft_face;
+        const size_t allocated = freetype_allocated;
         error = FT_New_Memory_Face(library, fns->bytes, fns->size, i, &ft_face);
         if (error)
         {
@@ -114,19 +409,53 @@ std::vector<FT_FaceRec> LoadFontFromBytes(std::vector<unsigned char> font)
             return rtn;
         }
 
-        face_map[ft_face->family_name][ft_face->style_name] = std::make_unique<Font>(ft_face, fns);
+        auto loaded = std::make_unique<Font>(ft_face, fns, (long)(freetype_allocated - allocated));
+        auto &entry = face_map[ft_face->family_name][ft_face->style_name];
+        if (entry != nullptr && entry->face == nullptr)
+        {
+            loaded->Restore(*entry);
+        }
+        if (entry.get() == current_font)
+        {
+            current_face = NULL;
+            current_font = nullptr;
+        }
+        entry = std::move(loaded);
         rtn.push_back(*ft_face);
     }
 
+    // Returned faces are read after this function returns, keep them loaded
+    EnforceFacePoolBudget(fns.get());
+
     return rtn;
 }
 
+// Load the font containing the evicted face again from the font provider
+void ReloadFont(std::string familyName, std::string styleName)
+{
+    if (font_provider.isNull() || font_provider.isUndefined())
+    {
+        fprintf(stderr, "FreeType: Font '%s %s' is evicted and no font provider is set.\n", familyName.c_str(), styleName.c_str());
+        return;
+    }
+
+    emscripten::val bytes = font_provider(familyName, styleName);
+    if (bytes.isNull() || bytes.isUndefined())
+    {
+        fprintf(stderr, "FreeType: Font provider did not return bytes for '%s %s'.\n", familyName.c_str(), styleName.c_str());
+        return;
+    }
+
+    LoadFontFromBytes(emscripten::convertJSArrayToNumberVector<unsigned char>(bytes));
+}
+
 void UnloadFont(std::string familyName)
 {
     // Unset current face if it matches
     if (current_face != NULL && current_face->family_name == familyName)
     {
         current_face = NULL;
+        current_font = nullptr;
     }
 
     // Unload faces
@@ -136,14 +465,65 @@ void UnloadFont(std::string familyName)
 emscripten::val SetFont(std::string faceName, std::string styleName)
 {
     auto ptr = face_map[faceName][styleName].get();
-    if (ptr == nullptr)
+    if (ptr != nullptr && ptr->face == nullptr)
+    {
+        ReloadFont(faceName, styleName);
+        ptr = face_map[faceName][styleName].get();
+    }
+    if (ptr == nullptr || ptr->face == nullptr)
     {
         return emscripten::val::null();
     }
-    current_face = face_map[faceName][styleName]->face;
+    current_face = ptr->face;
+    current_font = ptr;
+    ptr->bytes->last_used = ++face_pool_tick;
+    EnforceFacePoolBudget(nullptr);
     return emscripten::val(*current_face);
 }
 
+void SetFacePoolBudget(size_t budget)
+{
+    face_pool_budget = budget;
+    EnforceFacePoolBudget(nullptr);
+}
+
+void SetFontProvider(emscripten::val provider)
+{
+    font_provider = provider;
+}
+
+// Memory used by the loaded fonts, bytes shared by the faces of a font
+// collection are counted once
+size_t GetFacePoolUsage()
+{
+    return face_pool_used;
+}
+
+emscripten::val GetFacePoolFaces()
+{
+    emscripten::val rtn = emscripten::val::array();
+    for (auto &[family_name, styles] : face_map)
+    {
+        for (auto &[style_name, font] : styles)
+        {
+            if (font == nullptr)
+            {
+                continue;
+            }
+            const bool loaded = font->face != nullptr;
+            emscripten::val entry = emscripten::val::object();
+            entry.set("family_name", family_name);
+            entry.set("style_name", style_name);
+            entry.set("loaded", loaded);
+            entry.set("face_bytes", loaded ? font->face_memory : 0);
+            entry.set("font_bytes", loaded ? font->bytes->size : 0);
+            entry.set("last_used", loaded ? font->bytes->last_used : 0);
+            rtn.call<void>("push", entry);
+        }
+    }
+    return rtn;
+}
+
 emscripten::val SetCharSize(FT_F26Dot6 char_width, FT_F26Dot6 char_height, FT_UInt horz_resolution, FT_UInt vert_resolution)
 {
 
@@ -153,6 +533,7 @@ emscripten::val SetCharSize(FT_F26Dot6 char_width, FT_F26Dot6 char_height, FT_UI
         return emscripten::val::null();
     }
 
+    FaceMemoryScope scope(current_font);
     FT_Error error = FT_Set_Char_Size(current_face, char_width, char_height, horz_resolution, vert_resolution);
     if (error)
     {
@@ -160,6 +541,12 @@ emscripten::val SetCharSize(FT_F26Dot6 char_width, FT_F26Dot6 char_height, FT_UI
         return emscripten::val::null();
     }
 
+    current_font->size_request = Font::SizeRequest::Char;
+    current_font->size_width = char_width;
+    current_font->size_height = char_height;
+    current_font->horz_resolution = horz_resolution;
+    current_font->vert_resolution = vert_resolution;
+
     return emscripten::val(current_face->size->metrics);
 }
 
@@ -174,6 +561,7 @@ emscripten::val SetPixelSize(
         return emscripten::val::null();
     }
 
+    FaceMemoryScope scope(current_font);
     FT_Error error = FT_Set_Pixel_Sizes(current_face, pixel_width, pixel_height);
     if (error)
     {
@@ -181,6 +569,10 @@ emscripten::val SetPixelSize(
         return emscripten::val::null();
     }
 
+    current_font->size_request = Font::SizeRequest::Pixel;
+    current_font->size_width = pixel_width;
+    current_font->size_height = pixel_height;
+
     return emscripten::val(current_face->size->metrics);
 }
 
@@ -243,6 +635,410 @@ emscripten::val SetCharmapByIndex(int index)
 //     FT_Set_Transform(current_face, NULL, &pen);
 // }
 
+// Glyph cache and snapshots
+//
+// Snapshot is a little endian binary blob:
+//
+//   "FTGC" magic, u32 version, u32 set count, then for each set:
+//   u32 font checksum, family and style names (u32 length + bytes),
+//   size metrics, u32 glyph count + glyphs, u32 kerning count + kernings
+
+const FT_UInt32 GLYPH_SNAPSHOT_MAGIC = 0x43475446; // "FTGC"
+const FT_UInt32 GLYPH_SNAPSHOT_VERSION = 2;
+
+class SnapshotWriter
+{
+public:
+    void U8(FT_Byte v)
+    {
+        data.push_back(v);
+    }
+
+    void U16(FT_UInt16 v)
+    {
+        U8(v & 0xff);
+        U8(v >> 8);
+    }
+
+    void U32(FT_UInt32 v)
+    {
+        U16(v & 0xffff);
+        U16(v >> 16);
+    }
+
+    void I32(FT_Int32 v)
+    {
+        U32((FT_UInt32)v);
+    }
+
+    void Bytes(const unsigned char *bytes, size_t size)
+    {
+        U32(size);
+        data.insert(data.end(), bytes, bytes + size);
+    }
+
+    void String(const std::string &str)
+    {
+        Bytes((const unsigned char *)str.data(), str.size());
+    }
+
+    std::vector<unsigned char> data;
+};
+
+class SnapshotReader
+{
+public:
+    SnapshotReader(const std::vector<unsigned char> &snapshot) : data(snapshot) {}
+
+    FT_Byte U8()
+    {
+        if (pos + 1 > data.size())
+        {
+            ok = false;
+            return 0;
+        }
+        return data[pos++];
+    }
+
+    FT_UInt16 U16()
+    {
+        FT_UInt16 lo = U8();
+        return lo | (U8() << 8);
+    }
+
+    FT_UInt32 U32()
+    {
+        FT_UInt32 lo = U16();
+        return lo | ((FT_UInt32)U16() << 16);
+    }
+
+    FT_Int32 I32()
+    {
+        return (FT_Int32)U32();
+    }
+
+    std::vector<unsigned char> Bytes()
+    {
+        FT_UInt32 size = U32();
+        if (!ok || size > data.size() - pos)
+        {
+            ok = false;
+            return {};
+        }
+        std::vector<unsigned char> rtn(data.begin() + pos, data.begin() + pos + size);
+        pos += size;
+        return rtn;
+    }
+
+    std::string String()
+    {
+        auto bytes = Bytes();
+        return std::string(bytes.begin(), bytes.end());
+    }
+
+    bool ok = true;
+
+private:
+    const std::vector<unsigned char> &data;
+    size_t pos = 0;
+};
+
+// Cache set for the current face and size, nullptr if it does not exist and
+// `create` is not set
+GlyphCacheSet *GetGlyphCacheSet(bool create)
+{
+    if (current_face == NULL || current_face->size == NULL || (!create && glyph_cache.empty()))
+    {
+        return nullptr;
+    }
+
+    const auto &metrics = current_face->size->metrics;
+    GlyphCacheKey key = {
+        current_font->bytes->Checksum(),
+        current_face->family_name,
+        current_face->style_name,
+        metrics.x_ppem,
+        metrics.y_ppem,
+        metrics.x_scale,
+        metrics.y_scale};
+
+    auto it = glyph_cache.find(key);
+    if (it != glyph_cache.end())
+    {
+        return &it->second;
+    }
+    if (!create)
+    {
+        return nullptr;
+    }
+
+    auto &set = glyph_cache[key];
+    set.metrics = metrics;
+    return &set;
+}
+
+CachedGlyph *FindCachedGlyph(GlyphCacheSet *set, FT_Int32 load_flags, FT_UInt glyph_index)
+{
+    if (set == nullptr)
+    {
+        return nullptr;
+    }
+
+    auto it = set->glyphs.find({load_flags, glyph_index});
+    return it != set->glyphs.end() ? &it->second : nullptr;
+}
+
+// Copy the glyph loaded to the current_face->glyph slot to the cache
+void StoreCachedGlyph(GlyphCacheSet *set, FT_Int32 load_flags, FT_UInt glyph_index)
+{
+    if (!glyph_cache_enabled || set == nullptr)
+    {
+        return;
+    }
+
+    const FT_GlyphSlot glyph = current_face->glyph;
+    CachedGlyph &cached = set->glyphs[{load_flags, glyph_index}];
+
+    // Only the fields exposed to JS are kept
+    cached.slot = FT_GlyphSlotRec();
+    cached.slot.glyph_index = glyph->glyph_index;
+    cached.slot.linearHoriAdvance = glyph->linearHoriAdvance;
+    cached.slot.linearVertAdvance = glyph->linearVertAdvance;
+    cached.slot.advance = glyph->advance;
+    cached.slot.metrics = glyph->metrics;
+    cached.slot.format = glyph->format;
+    cached.slot.bitmap = glyph->bitmap;
+    cached.slot.bitmap.buffer = nullptr;
+    cached.slot.bitmap_left = glyph->bitmap_left;
+    cached.slot.bitmap_top = glyph->bitmap_top;
+
+    const auto bufsize = glyph->bitmap.rows * abs(glyph->bitmap.pitch);
+    if (glyph->bitmap.buffer != nullptr && bufsize > 0)
+    {
+        cached.buffer.assign(glyph->bitmap.buffer, glyph->bitmap.buffer + bufsize);
+    }
+    else
+    {
+        cached.buffer.clear();
+    }
+}
+
+emscripten::val CachedGlyphToVal(const CachedGlyph &cached)
+{
+    // Dimensions are kept as loaded, ImageData_Getter returns null for the
+    // glyphs without a buffer
+    FT_GlyphSlotRec slot = cached.slot;
+    slot.bitmap.buffer = cached.buffer.empty() ? nullptr : (unsigned char *)cached.buffer.data();
+    return emscripten::val(slot);
+}
+
+void EnableGlyphCache(bool enable)
+{
+    glyph_cache_enabled = enable;
+}
+
+void ClearGlyphCache()
+{
+    glyph_cache.clear();
+}
+
+emscripten::val ExportGlyphCache()
+{
+    SnapshotWriter w;
+    w.U32(GLYPH_SNAPSHOT_MAGIC);
+    w.U32(GLYPH_SNAPSHOT_VERSION);
+    w.U32(glyph_cache.size());
+
+    for (auto &[key, set] : glyph_cache)
+    {
+        w.U32(key.checksum);
+        w.String(key.family_name);
+        w.String(key.style_name);
+
+        w.U16(set.metrics.x_ppem);
+        w.U16(set.metrics.y_ppem);
+        w.I32(set.metrics.x_scale);
+        w.I32(set.metrics.y_scale);
+        w.I32(set.metrics.ascender);
+        w.I32(set.metrics.descender);
+        w.I32(set.metrics.height);
+        w.I32(set.metrics.max_advance);
+
+        w.U32(set.glyphs.size());
+        for (auto &[glyph_key, cached] : set.glyphs)
+        {
+            const FT_GlyphSlotRec &slot = cached.slot;
+            w.I32(glyph_key.first);
+            w.U32(glyph_key.second);
+            w.U32(slot.glyph_index);
+            w.I32(slot.linearHoriAdvance);
+            w.I32(slot.linearVertAdvance);
+            w.I32(slot.advance.x);
+            w.I32(slot.advance.y);
+            w.I32(slot.metrics.width);
+            w.I32(slot.metrics.height);
+            w.I32(slot.metrics.horiBearingX);
+            w.I32(slot.metrics.horiBearingY);
+            w.I32(slot.metrics.horiAdvance);
+            w.I32(slot.metrics.vertBearingX);
+            w.I32(slot.metrics.vertBearingY);
+            w.I32(slot.metrics.vertAdvance);
+            w.U32(slot.format);
+            w.I32(slot.bitmap_left);
+            w.I32(slot.bitmap_top);
+            w.U32(slot.bitmap.rows);
+            w.U32(slot.bitmap.width);
+            w.I32(slot.bitmap.pitch);
+            w.U16(slot.bitmap.num_grays);
+            w.U8(slot.bitmap.pixel_mode);
+            w.Bytes(cached.buffer.data(), cached.buffer.size());
+        }
+
+        w.U32(set.kerning.size());
+        for (auto &[kerning_key, vector] : set.kerning)
+        {
+            w.U32(std::get<0>(kerning_key));
+            w.U32(std::get<1>(kerning_key));
+            w.U32(std::get<2>(kerning_key));
+            w.I32(vector.x);
+            w.I32(vector.y);
+        }
+    }
+
+    // Copy out of the wasm memory, the vector is freed on return
+    return emscripten::val(emscripten::typed_memory_view(w.data.size(), w.data.data())).call<emscripten::val>("slice");
+}
+
+bool ImportGlyphCache(emscripten::val bytes)
+{
+    // Typed array is copied at once, std::vector argument would copy it
+    // element by element
+    const auto snapshot = emscripten::convertJSArrayToNumberVector<unsigned char>(bytes);
+    SnapshotReader r(snapshot);
+    if (r.U32() != GLYPH_SNAPSHOT_MAGIC)
+    {
+        fprintf(stderr, "FreeType: Glyph snapshot is not valid.\n");
+        return false;
+    }
+    FT_UInt32 version = r.U32();
+    if (version != GLYPH_SNAPSHOT_VERSION)
+    {
+        fprintf(stderr, "FreeType: Glyph snapshot version '%u' is not supported.\n", version);
+        return false;
+    }
+
+    // Read everything before touching the cache, so that a truncated
+    // snapshot does not leave it half populated
+    std::map<GlyphCacheKey, GlyphCacheSet> imported;
+    FT_UInt32 num_sets = r.U32();
+    for (FT_UInt32 i = 0; i < num_sets && r.ok; i++)
+    {
+        GlyphCacheKey key;
+        key.checksum = r.U32();
+        key.family_name = r.String();
+        key.style_name = r.String();
+
+        FT_Size_Metrics metrics;
+        metrics.x_ppem = r.U16();
+        metrics.y_ppem = r.U16();
+        metrics.x_scale = r.I32();
+        metrics.y_scale = r.I32();
+        metrics.ascender = r.I32();
+        metrics.descender = r.I32();
+        metrics.height = r.I32();
+        metrics.max_advance = r.I32();
+
+        key.x_ppem = metrics.x_ppem;
+        key.y_ppem = metrics.y_ppem;
+        key.x_scale = metrics.x_scale;
+        key.y_scale = metrics.y_scale;
+
+        GlyphCacheSet &set = imported[key];
+        set.metrics = metrics;
+
+        FT_UInt32 num_glyphs = r.U32();
+        for (FT_UInt32 k = 0; k < num_glyphs && r.ok; k++)
+        {
+            FT_Int32 load_flags = r.I32();
+            FT_UInt glyph_index = r.U32();
+            CachedGlyph &cached = set.glyphs[{load_flags, glyph_index}];
+            FT_GlyphSlotRec &slot = cached.slot;
+            slot = FT_GlyphSlotRec();
+            slot.glyph_index = r.U32();
+            slot.linearHoriAdvance = r.I32();
+            slot.linearVertAdvance = r.I32();
+            slot.advance.x = r.I32();
+            slot.advance.y = r.I32();
+            slot.metrics.width = r.I32();
+            slot.metrics.height = r.I32();
+            slot.metrics.horiBearingX = r.I32();
+            slot.metrics.horiBearingY = r.I32();
+            slot.metrics.horiAdvance = r.I32();
+            slot.metrics.vertBearingX = r.I32();
+            slot.metrics.vertBearingY = r.I32();
+            slot.metrics.vertAdvance = r.I32();
+            slot.format = (FT_Glyph_Format)r.U32();
+            slot.bitmap_left = r.I32();
+            slot.bitmap_top = r.I32();
+            slot.bitmap.rows = r.U32();
+            slot.bitmap.width = r.U32();
+            slot.bitmap.pitch = r.I32();
+            slot.bitmap.num_grays = r.U16();
+            slot.bitmap.pixel_mode = r.U8();
+            cached.buffer = r.Bytes();
+
+            // Snapshots come from outside, ImageData_Getter trusts the bitmap
+            // dimensions. Checked in 64 bits as the 32 bit products can wrap.
+            if (slot.bitmap.pitch == INT_MIN)
+            {
+                r.ok = false;
+            }
+            else if (!cached.buffer.empty())
+            {
+                const uint64_t rows = slot.bitmap.rows;
+                const uint64_t width = slot.bitmap.width;
+                const uint64_t apitch = abs(slot.bitmap.pitch);
+                bool fits = rows * apitch == cached.buffer.size() && rows * width * 4 <= UINT32_MAX;
+                if (slot.bitmap.pixel_mode == FT_PIXEL_MODE_MONO)
+                {
+                    fits = fits && apitch * 8 >= width;
+                }
+                else if (slot.bitmap.pixel_mode == FT_PIXEL_MODE_GRAY && slot.bitmap.num_grays == 256)
+                {
+                    fits = fits && apitch <= width;
+                }
+                r.ok = r.ok && fits;
+            }
+        }
+
+        FT_UInt32 num_kernings = r.U32();
+        for (FT_UInt32 k = 0; k < num_kernings && r.ok; k++)
+        {
+            FT_UInt left_glyph_index = r.U32();
+            FT_UInt right_glyph_index = r.U32();
+            FT_UInt kern_mode = r.U32();
+            FT_Vector &vector = set.kerning[{left_glyph_index, right_glyph_index, kern_mode}];
+            vector.x = r.I32();
+            vector.y = r.I32();
+        }
+    }
+
+    if (!r.ok)
+    {
+        fprintf(stderr, "FreeType: Glyph snapshot is truncated or corrupted.\n");
+        return false;
+    }
+
+    for (auto &[key, set] : imported)
+    {
+        auto &target = glyph_cache[key];
+        target.metrics = set.metrics;
+        target.glyphs.merge(set.glyphs);
+        target.kerning.merge(set.kerning);
+    }
+    return true;
+}
+
 // https://freetype.org/freetype2/docs/reference/ft2-base_interface.html#ft_load_xxx
 
 emscripten::val LoadGlyphsFromCharmap(FT_ULong first_charcode, FT_ULong last_charcode, FT_Int32 load_flags)
@@ -255,6 +1051,9 @@ emscripten::val LoadGlyphsFromCharmap(FT_ULong first_charcode, FT_ULong last_cha
         return mappe;
     }
 
+    // Glyph slot and hinter buffers are allocated when loading
+    FaceMemoryScope scope(current_font);
+    auto set = GetGlyphCacheSet(glyph_cache_enabled);
     FT_UInt gindex;
     FT_ULong charcode;
 
@@ -269,7 +1068,19 @@ emscripten::val LoadGlyphsFromCharmap(FT_ULong first_charcode, FT_ULong last_cha
 
     while (gindex != 0)
     {
-        FT_Error error = FT_Load_Char(current_face, charcode, load_flags);
+        auto cached = FindCachedGlyph(set, load_flags, gindex);
+        if (cached != nullptr)
+        {
+            mappe.call<void>("set", emscripten::val(charcode), CachedGlyphToVal(*cached));
+            charcode = FT_Get_Next_Char(current_face, charcode, &gindex);
+            if (charcode > last_charcode)
+            {
+                break;
+            }
+            continue;
+        }
+
+        FT_Error error = FT_Load_Glyph(current_face, gindex, load_flags);
         if (error)
         {
             fprintf(stderr, "Can't load char '%lu'\n", charcode);
@@ -280,6 +1091,7 @@ emscripten::val LoadGlyphsFromCharmap(FT_ULong first_charcode, FT_ULong last_cha
             }
             continue;
         }
+        StoreCachedGlyph(set, load_flags, gindex);
         mappe.call<void>("set", emscripten::val(charcode), emscripten::val(*current_face->glyph));
         charcode = FT_Get_Next_Char(current_face, charcode, &gindex);
         if (charcode > last_charcode)
@@ -299,14 +1111,31 @@ emscripten::val LoadGlyphs(std::vector<FT_ULong> charcodes, FT_Int32 load_flags)
         fprintf(stderr, "FreeType: Current font is not set.\n");
         return mappe;
     }
+
+    FaceMemoryScope scope(current_font);
+    auto set = GetGlyphCacheSet(glyph_cache_enabled);
     for (auto &c : charcodes)
     {
+        if (set != nullptr)
+        {
+            // Same glyph index FT_Load_Char uses, charcode is the index
+            // when no charmap is selected
+            const FT_UInt gindex = current_face->charmap != nullptr ? FT_Get_Char_Index(current_face, c) : (FT_UInt)c;
+            auto cached = FindCachedGlyph(set, load_flags, gindex);
+            if (cached != nullptr)
+            {
+                mappe.call<void>("set", emscripten::val(c), CachedGlyphToVal(*cached));
+                continue;
+            }
+        }
+
         FT_Error error = FT_Load_Char(current_face, c, load_flags);
         if (error)
         {
             fprintf(stderr, "Can't load char '%lu'\n", c);
             continue;
         }
+        StoreCachedGlyph(set, load_flags, current_face->glyph->glyph_index);
         mappe.call<void>("set", emscripten::val(c), emscripten::val(*current_face->glyph));
     }
 
@@ -322,12 +1151,26 @@ FT_Vector GetKerning(FT_UInt left_glyph_index, FT_UInt right_glyph_index, FT_UIn
         return vector;
     }
 
+    auto set = GetGlyphCacheSet(glyph_cache_enabled);
+    if (set != nullptr)
+    {
+        auto it = set->kerning.find({left_glyph_index, right_glyph_index, kern_mode});
+        if (it != set->kerning.end())
+        {
+            return it->second;
+        }
+    }
+
     FT_Error error = FT_Get_Kerning(current_face, left_glyph_index, right_glyph_index, kern_mode, &vector);
     if (error)
     {
         fprintf(stderr, "Unable to read kerning.\n");
         return vector;
     }
+    if (glyph_cache_enabled && set != nullptr)
+    {
+        set->kerning[{left_glyph_index, right_glyph_index, kern_mode}] = vector;
+    }
     return vector;
 }
 
@@ -399,8 +1242,9 @@ emscripten::val ImageData_Getter(const FT_Bitmap &v)
     const auto apitch = abs(v.pitch);
     const auto bufsize = v.rows * apitch;
 
-    // Whitespace characters don't have image data
-    if (bufsize == 0)
+    // Whitespace characters and glyphs loaded without rendering don't have
+    // image data
+    if (bufsize == 0 || v.buffer == nullptr)
     {
         return emscripten::val::null();
     }
@@ -482,6 +1326,14 @@ EMSCRIPTEN_BINDINGS(my_module)
     function("LoadGlyphs", &LoadGlyphs);
     function("LoadGlyphsFromCharmap", &LoadGlyphsFromCharmap);
     function("GetKerning", &GetKerning);
+    function("EnableGlyphCache", &EnableGlyphCache);
+    function("ClearGlyphCache", &ClearGlyphCache);
+    function("ExportGlyphCache", &ExportGlyphCache);
+    function("ImportGlyphCache", &ImportGlyphCache);
+    function("SetFacePoolBudget", &SetFacePoolBudget);
+    function("SetFontProvider", &SetFontProvider);
+    function("GetFacePoolUsage", &GetFacePoolUsage);
+    function("GetFacePoolFaces", &GetFacePoolFaces);
     function("Cleanup", &Cleanup);
 
     value_object<FT_Glyph_Metrics>("FT_Glyph_Metrics")
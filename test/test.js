@@ -9,12 +9,16 @@ async function createFontFromUrl(url) {
     return face;
 }
 
-async function createGoogleFont(fontName) {
+async function googleFontUrl(fontName) {
     const url = `https://fonts.googleapis.com/css?family=${fontName}&text=D`;
     const css = await fetch(url);
     const text = await css.text();
     const urls = [...text.matchAll(/url\(([^\(\)]+)\)/g)].map((m) => m[1]);
-    return await createFontFromUrl(urls[0]);
+    return urls[0];
+}
+
+async function createGoogleFont(fontName) {
+    return await createFontFromUrl(await googleFontUrl(fontName));
 }
 
 /**
@@ -115,6 +119,95 @@ consoleDrawGlyph(chard);
 console.log("You should see an monochrome letter D in the console:");
 consoleDrawGlyph(monod);
 
+Freetype.EnableGlyphCache(true);
+const cachedGlyphs = Freetype.LoadGlyphs([0x44], Freetype.FT_LOAD_RENDER);
+const snapshot = Freetype.ExportGlyphCache();
+Freetype.EnableGlyphCache(false);
+Freetype.ClearGlyphCache();
+console.assert(
+    Freetype.ImportGlyphCache(snapshot),
+    "🔴 Glyph snapshot not imported"
+);
+console.assert(
+    !Freetype.ImportGlyphCache(snapshot.slice(0, snapshot.length - 1)),
+    "🔴 Truncated glyph snapshot imported"
+);
+const importedd = Freetype.LoadGlyphs([0x44], Freetype.FT_LOAD_RENDER).get(0x44);
+console.assert(
+    importedd?.glyph_index === cachedGlyphs.get(0x44)?.glyph_index &&
+        importedd?.bitmap.imagedata?.data.join() ===
+            chard.bitmap.imagedata?.data.join(),
+    "🔴 Imported glyph differs",
+    importedd
+);
+
+// Patch bitmap_left of the only glyph in the snapshot, only a cache hit can
+// return it: header, checksum, family and style names, size metrics, glyph
+// count, then load flags, glyph index, slot fields before bitmap_left
+const bitmapLeftOffset =
+    12 + 4 + 4 + "Karla".length + 4 + "Regular".length + 28 + 4 + 64;
+const patched = snapshot.slice();
+new DataView(patched.buffer).setInt32(bitmapLeftOffset, 1234, true);
+Freetype.ClearGlyphCache();
+console.assert(
+    Freetype.ImportGlyphCache(patched),
+    "🔴 Patched glyph snapshot not imported"
+);
+const loadLeft = (flags) =>
+    Freetype.LoadGlyphs([0x44], flags).get(0x44)?.bitmap_left;
+console.assert(
+    loadLeft(Freetype.FT_LOAD_RENDER) === 1234,
+    "🔴 Glyph not returned from the cache"
+);
+console.assert(
+    loadLeft(Freetype.FT_LOAD_RENDER | Freetype.FT_LOAD_NO_HINTING) !== 1234,
+    "🔴 Cached glyph returned for different load flags"
+);
+Freetype.SetPixelSize(17, 0);
+console.assert(
+    loadLeft(Freetype.FT_LOAD_RENDER) !== 1234,
+    "🔴 Cached glyph returned for different size"
+);
+Freetype.SetPixelSize(16, 0);
+Freetype.ClearGlyphCache();
+
+const robotoFont = await fetch(await googleFontUrl("Roboto"));
+const robotoBytes = new Uint8Array(await robotoFont.arrayBuffer());
+const karlaFont = await fetch(await googleFontUrl("Karla"));
+const karlaBytes = new Uint8Array(await karlaFont.arrayBuffer());
+Freetype.SetFontProvider((familyName) =>
+    familyName === "Roboto" ? robotoBytes : karlaBytes
+);
+Freetype.LoadFontFromBytes(robotoBytes);
+Freetype.SetFacePoolBudget(1);
+const poolFaces = () =>
+    new Map(Freetype.GetFacePoolFaces().map((f) => [f.family_name, f]));
+console.assert(
+    poolFaces().get("Karla")?.loaded && !poolFaces().get("Roboto")?.loaded,
+    "🔴 Least recently used font not evicted",
+    Freetype.GetFacePoolFaces()
+);
+console.assert(
+    Freetype.SetFont("Roboto", "Regular")?.family_name === "Roboto",
+    "🔴 Evicted font not reloaded"
+);
+console.assert(
+    !poolFaces().get("Karla")?.loaded &&
+        poolFaces().get("Roboto")?.face_bytes > 0 &&
+        Freetype.GetFacePoolUsage() >= robotoBytes.length,
+    "🔴 Face pool memory not reported",
+    Freetype.GetFacePoolFaces()
+);
+const reloaded = Freetype.SetFont("Karla", "Regular");
+console.assert(
+    reloaded?.size.metrics.y_ppem === 16 &&
+        !poolFaces().get("Roboto")?.loaded,
+    "🔴 Size not restored after reload",
+    reloaded
+);
+Freetype.SetFacePoolBudget(0);
+Freetype.UnloadFont("Roboto");
+
 Freetype.UnloadFont("Karla");
 console.assert(null === Freetype.SetFont("Karla", "Regular"), " 🔴 Failure");
 Freetype.Cleanup();